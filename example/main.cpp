@@ -20,6 +20,7 @@
 // OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
 // SOFTWARE.
 
+#include <algorithm>
 #include <cstdint>
 #include <cstdio>
 #include <cstdlib>
@@ -27,6 +28,7 @@
 #include "stm32f4xx_ll_tim.h"
 #include "stm32f4xx_ll_gpio.h"
 #include "stm32f4xx_ll_adc.h"
+#include "stm32f4xx_ll_dma.h"
 #include "qpsk/decoder.h"
 
 constexpr uint32_t kAppStartAddress = FLASH_BASE + BOOTLOADER_SIZE;
@@ -36,7 +38,7 @@ constexpr uint32_t kGreenLEDPin  = GPIO_PIN_12;
 constexpr uint32_t kOrangeLEDPin = GPIO_PIN_13;
 constexpr uint32_t kBlueLEDPin   = GPIO_PIN_15;
 constexpr uint32_t kProfilingPin = GPIO_PIN_11;
-constexpr uint32_t kADCInterruptPin = GPIO_PIN_9;
+constexpr uint32_t kADCWaitPin   = GPIO_PIN_9;
 constexpr uint32_t kSwitchPin    = GPIO_PIN_0;
 
 static_assert(SAMPLE_RATE % SYMBOL_RATE == 0);
@@ -45,8 +47,24 @@ constexpr uint32_t kSymbolRate = SYMBOL_RATE;
 constexpr uint32_t kPacketSize = PACKET_SIZE;
 constexpr uint32_t kBlockSize = BLOCK_SIZE;
 constexpr uint32_t kCRCSeed = CRC_SEED;
-
-qpsk::Decoder<kSampleRate, kSymbolRate, kPacketSize, kBlockSize> decoder;
+constexpr uint32_t kADCBufferSize = 256;
+constexpr int32_t kADCOffset = 0x800;
+constexpr float kADCScale = 1.f / 2048.f;
+
+// Raw ADC samples are read in place from the DMA buffer at 2 bytes each and
+// converted to float in the main loop just before they're processed, so the
+// decoder's own FIFO only ever needs to hold a single sample. Since it can't
+// overflow, samples lost from the DMA buffer are reported as an overflow
+// instead.
+constexpr uint32_t kFifoCapacity = 1;
+
+qpsk::Decoder<kSampleRate, kSymbolRate, kPacketSize, kBlockSize, kFifoCapacity>
+    decoder;
+volatile uint16_t adc_buffer[kADCBufferSize];
+volatile uint32_t adc_laps;
+uint32_t adc_read_count;
+uint32_t adc_span;
+bool adc_overrun;
 
 #ifdef USE_FULL_ASSERT
 extern "C"
@@ -67,17 +85,91 @@ void SysTick_Handler(void)
     HAL_IncTick();
 }
 
-void ADC_IRQHandler(void)
+inline float ConvertSample(uint16_t data)
+{
+    return (static_cast<int32_t>(data) - kADCOffset) * kADCScale;
+}
+
+void DMA2_Stream0_IRQHandler(void)
+{
+    // Count each time the DMA wraps around adc_buffer, so that the main loop
+    // can tell whether it has been lapped.
+    if (LL_DMA_IsActiveFlag_TC0(DMA2))
+    {
+        LL_DMA_ClearFlag_TC0(DMA2);
+        adc_laps++;
+    }
+}
+
+// The DMA stream writes ADC samples into adc_buffer in circular mode, so the
+// buffer itself serves as the sample FIFO. Together with the number of times
+// the DMA has wrapped, its remaining transfer count tells us how many samples
+// it has written in total. Everything between that and the number we've read
+// is unread.
+uint32_t ADCWriteCount(void)
+{
+    __disable_irq();
+    uint32_t remaining = LL_DMA_GetDataLength(DMA2, LL_DMA_STREAM_0);
+    uint32_t laps = adc_laps;
+
+    // The DMA may have just wrapped without the interrupt having counted it
+    // yet.
+    if (LL_DMA_IsActiveFlag_TC0(DMA2) && remaining > kADCBufferSize / 2)
+    {
+        laps++;
+    }
+
+    __enable_irq();
+    return laps * kADCBufferSize + (kADCBufferSize - remaining);
+}
+
+// Find the unread samples that can be read contiguously from the buffer, i.e.
+// up to the DMA's write position or the end of the buffer, whichever is
+// first. Returns false if the DMA has lapped us, e.g. because the main loop
+// stalled, in which case the unread samples are no longer contiguous in time.
+bool FindSpan(void)
 {
-    LL_GPIO_SetOutputPin(GPIOD, kADCInterruptPin);
+    int32_t unread = ADCWriteCount() - adc_read_count;
+
+    if (unread >= static_cast<int32_t>(kADCBufferSize))
+    {
+        adc_span = 0;
+        return false;
+    }
 
-    // Get the sample from the ADC, convert to float, and pass it to the
-    // decoder.
-    int16_t data = LL_ADC_REG_ReadConversionData12(ADC1);
-    float sample = (data - 0x800) / 2048.f;
-    decoder.Push(sample);
+    uint32_t read_index = adc_read_count % kADCBufferSize;
+    adc_span = (unread > 0) ?
+        std::min<uint32_t>(unread, kADCBufferSize - read_index) : 0;
+    return true;
+}
 
-    LL_GPIO_ResetOutputPin(GPIOD, kADCInterruptPin);
+void FlushSamples(void)
+{
+    adc_read_count = ADCWriteCount();
+    adc_span = 0;
+    adc_overrun = false;
+}
+
+bool PopSample(float& sample)
+{
+    if (adc_span == 0)
+    {
+        if (!FindSpan())
+        {
+            // Samples have been lost. Stop reading until FlushSamples().
+            adc_overrun = true;
+        }
+
+        if (adc_span == 0)
+        {
+            return false;
+        }
+    }
+
+    sample = ConvertSample(adc_buffer[adc_read_count % kADCBufferSize]);
+    adc_read_count++;
+    adc_span--;
+    return true;
 }
 
 void InitOutputPins(void)
@@ -85,7 +177,7 @@ void InitOutputPins(void)
     __HAL_RCC_GPIOD_CLK_ENABLE();
 
     auto pins = kRedLEDPin | kGreenLEDPin | kOrangeLEDPin | kBlueLEDPin |
-        kProfilingPin | kADCInterruptPin;
+        kProfilingPin | kADCWaitPin;
 
     GPIO_InitTypeDef gpio_init =
     {
@@ -179,6 +271,42 @@ void InitTimer(void)
     LL_TIM_EnableCounter(TIM2);
 }
 
+void InitDMA(void)
+{
+    // ADC1 is served by DMA2 stream 0, channel 0
+    __HAL_RCC_DMA2_CLK_ENABLE();
+
+    LL_DMA_InitTypeDef dma_init =
+    {
+        .PeriphOrM2MSrcAddress  =
+            LL_ADC_DMA_GetRegAddr(ADC1, LL_ADC_DMA_REG_REGULAR_DATA),
+        .MemoryOrM2MDstAddress  = reinterpret_cast<uint32_t>(&adc_buffer[0]),
+        .Direction              = LL_DMA_DIRECTION_PERIPH_TO_MEMORY,
+        .Mode                   = LL_DMA_MODE_CIRCULAR,
+        .PeriphOrM2MSrcIncMode  = LL_DMA_PERIPH_NOINCREMENT,
+        .MemoryOrM2MDstIncMode  = LL_DMA_MEMORY_INCREMENT,
+        .PeriphOrM2MSrcDataSize = LL_DMA_PDATAALIGN_HALFWORD,
+        .MemoryOrM2MDstDataSize = LL_DMA_MDATAALIGN_HALFWORD,
+        .NbData                 = kADCBufferSize,
+        .Channel                = LL_DMA_CHANNEL_0,
+        .Priority               = LL_DMA_PRIORITY_HIGH,
+        .FIFOMode               = LL_DMA_FIFOMODE_DISABLE,
+        .FIFOThreshold          = LL_DMA_FIFOTHRESHOLD_1_4,
+        .MemBurst               = LL_DMA_MBURST_SINGLE,
+        .PeriphBurst            = LL_DMA_PBURST_SINGLE,
+    };
+    assert_param(SUCCESS == LL_DMA_Init(DMA2, LL_DMA_STREAM_0, &dma_init));
+    LL_DMA_EnableIT_TC(DMA2, LL_DMA_STREAM_0);
+    LL_DMA_EnableStream(DMA2, LL_DMA_STREAM_0);
+    adc_laps = 0;
+    adc_read_count = 0;
+    adc_span = 0;
+    adc_overrun = false;
+
+    HAL_NVIC_SetPriority(DMA2_Stream0_IRQn, 3, 0);
+    HAL_NVIC_EnableIRQ(DMA2_Stream0_IRQn);
+}
+
 void InitADC(void)
 {
     // PC4 = ADC12_IN14
@@ -213,7 +341,7 @@ void InitADC(void)
         .SequencerLength  = LL_ADC_REG_SEQ_SCAN_DISABLE,
         .SequencerDiscont = LL_ADC_REG_SEQ_DISCONT_DISABLE,
         .ContinuousMode   = LL_ADC_REG_CONV_SINGLE,
-        .DMATransfer      = LL_ADC_REG_DMA_TRANSFER_NONE,
+        .DMATransfer      = LL_ADC_REG_DMA_TRANSFER_UNLIMITED,
     };
     assert_param(SUCCESS == LL_ADC_REG_Init(ADC1, &adc_reg_init));
     LL_ADC_REG_SetSequencerRanks(ADC1, LL_ADC_REG_RANK_1, LL_ADC_CHANNEL_14);
@@ -221,10 +349,6 @@ void InitADC(void)
         LL_ADC_SAMPLINGTIME_144CYCLES);
     LL_ADC_REG_StartConversionExtTrig(ADC1, LL_ADC_REG_TRIG_EXT_RISING);
     LL_ADC_Enable(ADC1);
-    LL_ADC_EnableIT_EOCS(ADC1);
-
-    HAL_NVIC_SetPriority(ADC_IRQn, 3, 0);
-    HAL_NVIC_EnableIRQ(ADC_IRQn);
 }
 
 struct SectorInfo
@@ -312,6 +436,7 @@ int main(void)
     InitSwitch();
     InitPowerAndClock();
     InitTimer();
+    InitDMA();
     InitADC();
     decoder.Init(kCRCSeed);
     __enable_irq();
@@ -329,13 +454,25 @@ int main(void)
 
     for (;;)
     {
-        // We actually don't need to wait here for samples to be available.
-        // We only do so to make the profiling signal more informative.
-        while (!decoder.samples_available());
-
-        LL_GPIO_SetOutputPin(GPIOD, kProfilingPin);
-        auto result = decoder.Process();
-        LL_GPIO_ResetOutputPin(GPIOD, kProfilingPin);
+        // The decoder's FIFO holds only the sample being processed, so wait
+        // here for the next one. The wait is shown on its own pin alongside
+        // the profiling signal.
+        float sample;
+        LL_GPIO_SetOutputPin(GPIOD, kADCWaitPin);
+        while (!PopSample(sample) && !adc_overrun);
+        LL_GPIO_ResetOutputPin(GPIOD, kADCWaitPin);
+
+        // If the DMA lapped us, fail in the same way as if the decoder's own
+        // FIFO had overflowed.
+        auto result = qpsk::RESULT_ERROR;
+
+        if (!adc_overrun)
+        {
+            LL_GPIO_SetOutputPin(GPIOD, kProfilingPin);
+            decoder.Push(sample);
+            result = decoder.Process();
+            LL_GPIO_ResetOutputPin(GPIOD, kProfilingPin);
+        }
 
         if (result == qpsk::RESULT_PACKET_COMPLETE)
         {
@@ -353,6 +490,11 @@ int main(void)
 
             block_address += kBlockSize;
             LL_GPIO_ResetOutputPin(GPIOD, kWriteLED);
+
+            // The write takes far longer than the buffer lasts, so the DMA
+            // has lapped us. The encoder leaves a gap in the signal for the
+            // write, so skip to the newest sample and pick up from there.
+            FlushSamples();
         }
         else if (result == qpsk::RESULT_END)
         {
@@ -366,7 +508,7 @@ int main(void)
         {
             LL_GPIO_ResetOutputPin(GPIOD, kPacketLED);
 
-            switch (decoder.error())
+            switch (adc_overrun ? qpsk::ERROR_OVERFLOW : decoder.error())
             {
                 case qpsk::ERROR_SYNC:
                     LL_GPIO_SetOutputPin(GPIOD, kWriteLED);
@@ -395,6 +537,7 @@ int main(void)
             LL_GPIO_ResetOutputPin(GPIOD, kPacketLED);
 
             block_address = kAppStartAddress;
+            FlushSamples();
             decoder.Reset();
         }
     }
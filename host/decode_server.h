@@ -0,0 +1,645 @@
+// MIT License
+//
+// Copyright 2021 Tyler Coy
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <vector>
+#include <poll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include "host/engine.h"
+#include "qpsk/decoder.h"
+
+namespace qpsk::host
+{
+
+// Messages sent by the server. Each is a single packet on the connection,
+// made up of a MessageHeader followed by the message's payload, if any.
+enum MessageType : uint32_t
+{
+    // A block has been decoded. The value is the total number of bytes
+    // received so far, and the payload is the block's data.
+    MESSAGE_BLOCK,
+
+    // The input has been decoded completely. The value is the total number
+    // of bytes received.
+    MESSAGE_END,
+
+    // Decoding failed. The value is the decoder's Error, kErrorMessage, or
+    // kErrorIncomplete.
+    MESSAGE_ERROR,
+};
+
+// The value of the MESSAGE_ERROR sent when the client sends a packet that's
+// longer than kMaxMessageSamples or isn't a whole number of samples. It's
+// distinct from all of the decoder's Error values.
+constexpr uint32_t kErrorMessage = 0x100;
+
+// The value of the MESSAGE_ERROR sent when the client's input ends before the
+// decoder has reached either the end of the data or an error.
+constexpr uint32_t kErrorIncomplete = 0x101;
+
+struct MessageHeader
+{
+    uint32_t type;
+    uint32_t value;
+};
+
+// Decodes PCM streams sent over a local SOCK_SEQPACKET socket.
+//
+// Clients connect to the socket and send their input as packets of native
+// float samples, up to kMaxMessageSamples per packet. Each connection is
+// assigned one of max_connections decoders, all of which are allocated up
+// front and decoded by a shared Engine. Decoded blocks and status messages
+// are sent back on the same connection, ending with either MESSAGE_END or
+// MESSAGE_ERROR. When a client is done sending, it shuts down its side of
+// the connection; the server finishes decoding what it has received, then
+// closes the connection. While every decoder is in use, new clients wait in
+// the listen backlog.
+//
+// Blocks are sent straight out of the decoder's block buffer with sendmsg(),
+// and samples are received with recvmsg() into a buffer owned by the
+// connection, so nothing is allocated or copied per message beyond the copy
+// into the stream's Fifo. Messages are sent without blocking, so that a
+// client that isn't reading can't hold up the workers shared by every other
+// client. If a client's socket buffer is full, its stream is parked, and the
+// server stops reading its input, until the message can be sent. A client
+// that doesn't read anything for kSendTimeout is disconnected.
+template <uint32_t sample_rate, uint32_t symbol_rate,
+    uint32_t packet_size, uint32_t block_size>
+class DecodeServer
+{
+public:
+    using EngineType =
+        Engine<sample_rate, symbol_rate, packet_size, block_size>;
+    using DecoderType = typename EngineType::DecoderType;
+    using Clock = std::chrono::steady_clock;
+
+    static constexpr uint32_t kMaxMessageSamples = 1024;
+    static constexpr auto kSendTimeout = std::chrono::seconds(10);
+
+    ~DecodeServer()
+    {
+        Close();
+
+        if (stop_fd_ >= 0)
+        {
+            close(stop_fd_);
+        }
+    }
+
+    // Create the socket and start the workers. Returns false, with errno
+    // set, if the socket couldn't be created.
+    bool Init(const char* path, uint32_t max_connections,
+        uint32_t num_workers, uint32_t crc_seed)
+    {
+        sockaddr_un address = {};
+        address.sun_family = AF_UNIX;
+
+        if (strlen(path) >= sizeof(address.sun_path))
+        {
+            errno = ENAMETOOLONG;
+            return false;
+        }
+
+        strcpy(address.sun_path, path);
+        path_ = path;
+
+        // The stop eventfd outlives Run(), so that Stop() never races with
+        // it being closed.
+        if (stop_fd_ < 0)
+        {
+            stop_fd_ = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+        }
+        else
+        {
+            uint64_t value;
+            [[maybe_unused]] auto n = read(stop_fd_, &value, sizeof(value));
+        }
+
+        wake_fd_ = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+        listen_fd_ = socket(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0);
+
+        if (stop_fd_ < 0 || wake_fd_ < 0 || listen_fd_ < 0 ||
+            bind(listen_fd_, reinterpret_cast<sockaddr*>(&address),
+                sizeof(address)) < 0 ||
+            listen(listen_fd_, max_connections) < 0)
+        {
+            int error = errno;
+            Close();
+            errno = error;
+            return false;
+        }
+
+        bound_ = true;
+        num_connections_ = max_connections;
+        connections_ = std::make_unique<Connection[]>(max_connections);
+
+        engine_.Init(max_connections, num_workers, crc_seed,
+            [this](uint32_t stream, Result result, DecoderType& qpsk)
+            {
+                OnResult(stream, result, qpsk);
+            },
+            [this](uint32_t stream)
+            {
+                OnYield(stream);
+            });
+
+        return true;
+    }
+
+    // Serve clients until Stop() is called.
+    void Run(void)
+    {
+        std::vector<pollfd> fds;
+        std::vector<uint32_t> polled;
+
+        for (;;)
+        {
+            uint32_t free = num_connections_;
+            auto deadline = Clock::time_point::max();
+            polled.clear();
+
+            for (uint32_t i = 0; i < num_connections_; i++)
+            {
+                auto& c = connections_[i];
+
+                if (c.state == CONNECTION_FREE)
+                {
+                    free = i;
+                    continue;
+                }
+
+                if (c.blocked)
+                {
+                    deadline = std::min(deadline,
+                        c.blocked_since + kSendTimeout);
+                }
+
+                if ((c.state == CONNECTION_OPEN && c.length == 0) ||
+                    c.blocked)
+                {
+                    polled.push_back(i);
+                }
+            }
+
+            // Only accept a client while there's a decoder to give it.
+            // Otherwise it waits in the listen backlog.
+            bool accepting = (free < num_connections_);
+
+            fds.clear();
+            fds.push_back({stop_fd_, POLLIN, 0});
+            fds.push_back({wake_fd_, POLLIN, 0});
+            fds.push_back({accepting ? listen_fd_ : -1, POLLIN, 0});
+
+            for (auto i : polled)
+            {
+                auto& c = connections_[i];
+                fds.push_back({c.fd, short(c.blocked ? POLLOUT : POLLIN), 0});
+            }
+
+            int timeout = -1;
+
+            if (deadline != Clock::time_point::max())
+            {
+                auto wait = std::chrono::ceil<std::chrono::milliseconds>(
+                    deadline - Clock::now());
+                timeout = std::max<int>(wait.count(), 0);
+            }
+
+            if (poll(fds.data(), fds.size(), timeout) < 0 && errno != EINTR)
+            {
+                break;
+            }
+
+            if (fds[0].revents)
+            {
+                break;
+            }
+
+            if (fds[1].revents)
+            {
+                uint64_t value;
+                [[maybe_unused]] auto n = read(wake_fd_, &value,
+                    sizeof(value));
+            }
+
+            if (accepting && (fds[2].revents & POLLIN))
+            {
+                Accept(free);
+            }
+
+            for (uint32_t i = 0; i < polled.size(); i++)
+            {
+                if (fds[i + 3].revents)
+                {
+                    auto& c = connections_[polled[i]];
+
+                    if (c.blocked)
+                    {
+                        SendPending(polled[i]);
+                    }
+                    else
+                    {
+                        Receive(polled[i]);
+                    }
+                }
+            }
+
+            for (uint32_t i = 0; i < num_connections_; i++)
+            {
+                Update(i);
+            }
+        }
+
+        Close();
+    }
+
+    // Make Run() return. May be called from any thread, or from a signal
+    // handler.
+    void Stop(void)
+    {
+        uint64_t value = 1;
+        [[maybe_unused]] auto n = write(stop_fd_, &value, sizeof(value));
+    }
+
+protected:
+    enum ConnectionState
+    {
+        CONNECTION_FREE,
+        CONNECTION_OPEN,
+        CONNECTION_DRAINING,
+    };
+
+    struct Connection
+    {
+        ConnectionState state = CONNECTION_FREE;
+        int fd = -1;
+
+        // Set by the worker once it has reported the end of decoding.
+        bool finished;
+
+        // Set once nothing more can be sent to the client.
+        std::atomic<bool> failed;
+
+        // Set if the client sent an invalid packet.
+        bool invalid;
+
+        // Set once the connection's final status has been dealt with.
+        bool reported;
+
+        // Set while Run() is waiting for the stream to make room in its
+        // Fifo or to go idle, so that the worker wakes it up.
+        std::atomic<bool> waiting;
+
+        // Set when a message couldn't be sent without blocking. The message
+        // is kept here until the socket is writable. If it came from a
+        // worker, the stream is parked until then.
+        std::atomic<bool> blocked;
+        bool parked;
+        Clock::time_point blocked_since;
+        MessageHeader header;
+        const void* payload;
+        uint32_t payload_length;
+
+        // Samples received but not yet pushed to the engine.
+        uint32_t length;
+        float buffer[kMaxMessageSamples];
+    };
+
+    EngineType engine_;
+    std::unique_ptr<Connection[]> connections_;
+    uint32_t num_connections_ = 0;
+    std::string path_;
+    bool bound_ = false;
+    int listen_fd_ = -1;
+    int stop_fd_ = -1;
+    int wake_fd_ = -1;
+
+    void Accept(uint32_t index)
+    {
+        int fd = accept4(listen_fd_, nullptr, nullptr, SOCK_CLOEXEC);
+
+        if (fd < 0)
+        {
+            return;
+        }
+
+        auto& c = connections_[index];
+        c.state = CONNECTION_OPEN;
+        c.fd = fd;
+        c.finished = false;
+        c.failed = false;
+        c.invalid = false;
+        c.reported = false;
+        c.waiting = false;
+        c.blocked = false;
+        c.length = 0;
+    }
+
+    void Receive(uint32_t index)
+    {
+        auto& c = connections_[index];
+
+        iovec iov = {c.buffer, sizeof(c.buffer)};
+        msghdr message = {};
+        message.msg_iov = &iov;
+        message.msg_iovlen = 1;
+
+        ssize_t n = recvmsg(c.fd, &message, MSG_DONTWAIT);
+
+        if (n < 0 && (errno == EAGAIN || errno == EINTR))
+        {
+            return;
+        }
+        else if (n <= 0)
+        {
+            // The client has finished sending, or has gone away.
+            c.state = CONNECTION_DRAINING;
+            return;
+        }
+        else if ((message.msg_flags & MSG_TRUNC) || n % sizeof(float))
+        {
+            // Stop the workers sending anything more, and report the error
+            // once the stream has stopped decoding.
+            c.failed = true;
+            c.invalid = true;
+            c.state = CONNECTION_DRAINING;
+            return;
+        }
+
+        c.length = n / sizeof(float);
+    }
+
+    // Retry a message that couldn't be sent earlier.
+    void SendPending(uint32_t index)
+    {
+        auto& c = connections_[index];
+
+        if (Send(c.fd, c.header, c.payload, c.payload_length) ||
+            errno != EAGAIN)
+        {
+            Unblock(index);
+        }
+    }
+
+    void Unblock(uint32_t index)
+    {
+        auto& c = connections_[index];
+        c.blocked = false;
+
+        if (c.parked)
+        {
+            c.parked = false;
+            engine_.Resume(index);
+        }
+    }
+
+    void Update(uint32_t index)
+    {
+        auto& c = connections_[index];
+
+        if (c.state == CONNECTION_FREE)
+        {
+            return;
+        }
+
+        if (c.blocked && Clock::now() >= c.blocked_since + kSendTimeout)
+        {
+            // The client hasn't read anything for too long.
+            c.failed = true;
+            Unblock(index);
+        }
+
+        if (c.state == CONNECTION_OPEN && c.failed)
+        {
+            // Nothing more can be sent to the client. Stop reading from it,
+            // and let it know it's been disconnected.
+            shutdown(c.fd, SHUT_RDWR);
+            c.state = CONNECTION_DRAINING;
+            c.length = 0;
+        }
+
+        // Pairs with the fence in Engine::Run(). Either we see the room the
+        // worker made, or the stream going idle, or the worker sees that
+        // we're waiting and wakes us.
+        c.waiting = true;
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+
+        if (c.state == CONNECTION_OPEN && c.length > 0 && !c.blocked)
+        {
+            if (engine_.Push(index, c.buffer, c.length))
+            {
+                c.length = 0;
+            }
+        }
+        else if (c.state == CONNECTION_DRAINING && !c.blocked &&
+            engine_.idle(index))
+        {
+            Disconnect(index);
+        }
+
+        c.waiting = (c.state == CONNECTION_OPEN && c.length > 0) ||
+            c.state == CONNECTION_DRAINING;
+    }
+
+    // Report the connection's final status, if it hasn't been already, then
+    // close it.
+    void Disconnect(uint32_t index)
+    {
+        auto& c = connections_[index];
+
+        if (!c.reported)
+        {
+            c.reported = true;
+
+            if (c.invalid || (!c.finished && !c.failed))
+            {
+                c.header = {MESSAGE_ERROR,
+                    c.invalid ? kErrorMessage : kErrorIncomplete};
+                c.payload = nullptr;
+                c.payload_length = 0;
+
+                if (!Send(c.fd, c.header) && errno == EAGAIN)
+                {
+                    // Wait for the socket to be writable, and come back.
+                    c.parked = false;
+                    c.blocked_since = Clock::now();
+                    c.blocked = true;
+                    return;
+                }
+            }
+        }
+
+        close(c.fd);
+        c.fd = -1;
+        c.state = CONNECTION_FREE;
+        c.waiting = false;
+        engine_.Reset(index);
+    }
+
+    void Close(void)
+    {
+        // Make sure no worker is still sending before the sockets close.
+        // Sends don't block, but shut the sockets down first anyway so that
+        // nothing can hold up the workers.
+        for (uint32_t i = 0; i < num_connections_; i++)
+        {
+            if (connections_[i].fd >= 0)
+            {
+                shutdown(connections_[i].fd, SHUT_RDWR);
+            }
+        }
+
+        engine_.Stop();
+
+        for (uint32_t i = 0; i < num_connections_; i++)
+        {
+            if (connections_[i].fd >= 0)
+            {
+                close(connections_[i].fd);
+                connections_[i].fd = -1;
+                connections_[i].state = CONNECTION_FREE;
+            }
+        }
+
+        if (listen_fd_ >= 0)
+        {
+            close(listen_fd_);
+            listen_fd_ = -1;
+        }
+
+        if (wake_fd_ >= 0)
+        {
+            close(wake_fd_);
+            wake_fd_ = -1;
+        }
+
+        if (bound_)
+        {
+            unlink(path_.c_str());
+            bound_ = false;
+        }
+    }
+
+    // Wake Run(). May be called from any thread.
+    void Wake(void)
+    {
+        uint64_t value = 1;
+        [[maybe_unused]] auto n = write(wake_fd_, &value, sizeof(value));
+    }
+
+    // Called on a worker thread.
+    void OnResult(uint32_t stream, Result result, DecoderType& qpsk)
+    {
+        auto& c = connections_[stream];
+
+        if (c.finished || c.failed)
+        {
+            return;
+        }
+        else if (result == RESULT_BLOCK_COMPLETE)
+        {
+            c.header = {MESSAGE_BLOCK, qpsk.bytes_received()};
+            c.payload = qpsk.block_data();
+            c.payload_length = block_size;
+        }
+        else if (result == RESULT_END)
+        {
+            c.header = {MESSAGE_END, qpsk.bytes_received()};
+            c.payload = nullptr;
+            c.payload_length = 0;
+            c.finished = true;
+        }
+        else if (result == RESULT_ERROR)
+        {
+            c.header = {MESSAGE_ERROR, qpsk.error()};
+            c.payload = nullptr;
+            c.payload_length = 0;
+            c.finished = true;
+        }
+        else
+        {
+            return;
+        }
+
+        if (Send(c.fd, c.header, c.payload, c.payload_length))
+        {
+            return;
+        }
+        else if (errno == EAGAIN)
+        {
+            // The client isn't keeping up. Stop decoding its stream, which
+            // keeps the block data valid, until Run() has sent the message.
+            engine_.Park(stream);
+            c.parked = true;
+            c.blocked_since = Clock::now();
+            c.blocked = true;
+        }
+        else
+        {
+            // The client has gone away.
+            c.failed = true;
+        }
+
+        Wake();
+    }
+
+    // Called on a worker thread.
+    void OnYield(uint32_t stream)
+    {
+        if (connections_[stream].waiting)
+        {
+            Wake();
+        }
+    }
+
+    // Send a message without blocking. Returns false, with errno set, if it
+    // couldn't be sent.
+    bool Send(int fd, MessageHeader header, const void* payload = nullptr,
+        uint32_t length = 0)
+    {
+        iovec iov[2] =
+        {
+            {&header, sizeof(header)},
+            {const_cast<void*>(payload), length},
+        };
+
+        msghdr message = {};
+        message.msg_iov = iov;
+        message.msg_iovlen = payload ? 2 : 1;
+
+        return sendmsg(fd, &message, MSG_NOSIGNAL | MSG_DONTWAIT) >= 0;
+    }
+};
+
+}
@@ -0,0 +1,373 @@
+// MIT License
+//
+// Copyright 2021 Tyler Coy
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#pragma once
+
+#include <atomic>
+#include <cassert>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <vector>
+#include "qpsk/inc/fifo.h"
+#include "qpsk/decoder.h"
+
+namespace qpsk::host
+{
+
+// Decodes many independent streams on a fixed pool of worker threads.
+//
+// Each stream has its own Decoder and its own sample Fifo, which is filled by
+// Push() from whatever thread is reading that stream's input. A stream with
+// samples waiting is queued on one of the workers; a worker that runs out of
+// queued streams steals from the others, so pending work migrates to idle
+// workers. A stream is only ever queued on or run by one worker at a time, so
+// its Fifo keeps a single consumer and its Decoder needs no locking.
+//
+// Results are reported through the callback on the worker that produced them.
+// The callback has exclusive access to the stream's decoder for its duration,
+// so it may read block_data() or packet_data(), or call Abort() or Reset().
+// If it can't deal with a result straight away, e.g. because the block can't
+// be written anywhere yet, it can Park() the stream, which stops it being
+// decoded until Resume() is called. The decoder is left as it was, so the
+// block or packet data stays valid in the meantime.
+template <uint32_t sample_rate, uint32_t symbol_rate,
+    uint32_t packet_size, uint32_t block_size, uint32_t fifo_capacity = 4096>
+class Engine
+{
+public:
+    using DecoderType =
+        Decoder<sample_rate, symbol_rate, packet_size, block_size, 1>;
+    using Callback =
+        std::function<void(uint32_t stream, Result result, DecoderType&)>;
+    using YieldCallback = std::function<void(uint32_t stream)>;
+
+    // Maximum number of samples a worker decodes from one stream before
+    // giving other streams a turn.
+    static constexpr uint32_t kQuantum = 1024;
+
+    ~Engine()
+    {
+        Stop();
+    }
+
+    // If given, yield_callback is called on the worker each time it finishes a
+    // turn on a stream, having made room in the stream's Fifo or possibly left
+    // the stream idle. It lets a producer wait for either without polling.
+    void Init(uint32_t num_streams, uint32_t num_workers, uint32_t crc_seed,
+        Callback callback, YieldCallback yield_callback = nullptr)
+    {
+        assert(num_streams > 0 && num_workers > 0);
+        assert(workers_.empty());
+
+        callback_ = callback;
+        yield_callback_ = yield_callback;
+        stop_ = false;
+        pending_ = 0;
+        next_queue_ = 0;
+
+        streams_.clear();
+        for (uint32_t i = 0; i < num_streams; i++)
+        {
+            streams_.emplace_back(std::make_unique<Stream>());
+            streams_[i]->samples.Init();
+            streams_[i]->decoder.Init(crc_seed);
+            streams_[i]->scheduled = false;
+            streams_[i]->park = PARK_NONE;
+        }
+
+        num_queues_ = num_workers;
+        queues_ = std::make_unique<Queue[]>(num_workers);
+
+        for (uint32_t i = 0; i < num_workers; i++)
+        {
+            workers_.emplace_back(&Engine::Work, this, i);
+        }
+    }
+
+    // Stop the workers. Each finishes the quantum it's running, if any, and
+    // samples that haven't been decoded yet are discarded.
+    void Stop(void)
+    {
+        {
+            std::lock_guard<std::mutex> lock(sleep_mutex_);
+            stop_ = true;
+        }
+
+        sleep_cv_.notify_all();
+
+        for (auto& worker : workers_)
+        {
+            worker.join();
+        }
+
+        workers_.clear();
+    }
+
+    // Queue samples for a stream. Each stream must be pushed to by only one
+    // thread at a time. Returns false, without queueing anything, if the
+    // stream's Fifo doesn't have room for the whole buffer.
+    bool Push(uint32_t stream, float* buffer, uint32_t length)
+    {
+        if (!streams_[stream]->samples.Push(buffer, length))
+        {
+            return false;
+        }
+
+        Schedule(stream, next_queue_++ % num_queues_);
+        return true;
+    }
+
+    // Stop decoding the stream once the callback returns. May only be called
+    // from the callback, for the stream it was called for.
+    void Park(uint32_t stream)
+    {
+        streams_[stream]->park = PARK_PENDING;
+    }
+
+    // Carry on decoding a parked stream. May be called from any thread, but
+    // only once per call to Park().
+    void Resume(uint32_t stream)
+    {
+        auto& s = *streams_[stream];
+
+        // If the worker hasn't stopped yet, it now won't.
+        uint32_t expected = PARK_PENDING;
+        if (s.park.compare_exchange_strong(expected, PARK_NONE))
+        {
+            return;
+        }
+
+        // Otherwise, the stream is still marked as scheduled, so queue it
+        // directly.
+        expected = PARKED;
+        if (s.park.compare_exchange_strong(expected, PARK_NONE))
+        {
+            Enqueue(stream, next_queue_++ % num_queues_);
+        }
+    }
+
+    // Whether the stream has no samples waiting and isn't being decoded or
+    // parked.
+    bool idle(uint32_t stream)
+    {
+        auto& s = *streams_[stream];
+        return !s.scheduled.load() && s.samples.empty();
+    }
+
+    // Reset a stream's decoder, e.g. so that it can be reused for a new
+    // input. The stream must be idle, and nothing may push to it until this
+    // returns.
+    void Reset(uint32_t stream)
+    {
+        assert(idle(stream));
+        streams_[stream]->decoder.Reset();
+    }
+
+    uint32_t num_streams(void)
+    {
+        return streams_.size();
+    }
+
+protected:
+    struct Stream
+    {
+        Fifo<float, fifo_capacity> samples;
+        DecoderType decoder;
+        std::atomic<bool> scheduled;
+        std::atomic<uint32_t> park;
+    };
+
+    enum ParkState : uint32_t
+    {
+        PARK_NONE,
+        PARK_PENDING,
+        PARKED,
+    };
+
+    struct Queue
+    {
+        std::mutex mutex;
+        std::deque<uint32_t> streams;
+    };
+
+    Callback callback_;
+    YieldCallback yield_callback_;
+    std::vector<std::unique_ptr<Stream>> streams_;
+    std::unique_ptr<Queue[]> queues_;
+    uint32_t num_queues_;
+    std::atomic<uint32_t> next_queue_;
+    std::vector<std::thread> workers_;
+
+    std::mutex sleep_mutex_;
+    std::condition_variable sleep_cv_;
+    std::atomic<uint32_t> pending_;
+    std::atomic<bool> stop_;
+
+    // Queue the stream on the given worker, unless it's already queued or
+    // running somewhere.
+    void Schedule(uint32_t stream, uint32_t queue)
+    {
+        // Pairs with the fence in Run(). Either the worker sees the samples
+        // we just pushed, or we see that the stream is no longer scheduled.
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+
+        bool expected = false;
+        if (streams_[stream]->scheduled.compare_exchange_strong(expected,
+            true))
+        {
+            Enqueue(stream, queue);
+        }
+    }
+
+    void Enqueue(uint32_t stream, uint32_t queue)
+    {
+        // Count the stream as pending before it can be taken, so that Take()
+        // never decrements the count below zero.
+        {
+            std::lock_guard<std::mutex> lock(queues_[queue].mutex);
+            pending_++;
+            queues_[queue].streams.push_back(stream);
+        }
+
+        // A worker that's about to sleep checks pending_ while holding the
+        // sleep mutex, so taking it here makes sure that worker either sees
+        // the new count or is already waiting to be notified.
+        {
+            std::lock_guard<std::mutex> lock(sleep_mutex_);
+        }
+
+        sleep_cv_.notify_one();
+    }
+
+    // Take the least recently queued stream from our own queue, or else steal
+    // the most recently queued stream from another worker. Streams that are
+    // requeued after using up their quantum go to the back of the queue, so
+    // each worker round-robins over the streams queued on it.
+    bool Take(uint32_t id, uint32_t& stream)
+    {
+        for (uint32_t i = 0; i < num_queues_; i++)
+        {
+            auto& queue = queues_[(id + i) % num_queues_];
+            std::lock_guard<std::mutex> lock(queue.mutex);
+
+            if (!queue.streams.empty())
+            {
+                if (i == 0)
+                {
+                    stream = queue.streams.front();
+                    queue.streams.pop_front();
+                }
+                else
+                {
+                    stream = queue.streams.back();
+                    queue.streams.pop_back();
+                }
+
+                pending_--;
+                return true;
+            }
+        }
+
+        return false;
+    }
+
+    void Run(uint32_t id, uint32_t stream)
+    {
+        auto& s = *streams_[stream];
+
+        for (uint32_t i = 0; i < kQuantum; i++)
+        {
+            float sample;
+
+            if (!s.samples.Pop(sample))
+            {
+                break;
+            }
+
+            s.decoder.Push(sample);
+            Result result = s.decoder.Process();
+
+            if (result == RESULT_PACKET_COMPLETE ||
+                result == RESULT_BLOCK_COMPLETE ||
+                result == RESULT_END ||
+                result == RESULT_ERROR)
+            {
+                callback_(stream, result, s.decoder);
+
+                // Leave the stream marked as scheduled, so that nothing else
+                // queues it until it's resumed.
+                uint32_t expected = PARK_PENDING;
+                if (s.park.compare_exchange_strong(expected, PARKED))
+                {
+                    return;
+                }
+            }
+        }
+
+        s.scheduled.store(false);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+
+        // More samples may have arrived while we were running, or we may have
+        // used up our quantum. Requeue the stream behind the others on our own
+        // queue, where an idle worker can also steal it.
+        if (!s.samples.empty())
+        {
+            Schedule(stream, id);
+        }
+
+        if (yield_callback_)
+        {
+            yield_callback_(stream);
+        }
+    }
+
+    void Work(uint32_t id)
+    {
+        for (;;)
+        {
+            uint32_t stream;
+
+            if (stop_)
+            {
+                return;
+            }
+            else if (Take(id, stream))
+            {
+                Run(id, stream);
+                continue;
+            }
+
+            std::unique_lock<std::mutex> lock(sleep_mutex_);
+            sleep_cv_.wait(lock, [this](void)
+            {
+                return stop_ || pending_ > 0;
+            });
+        }
+    }
+};
+
+}
@@ -0,0 +1,90 @@
+// MIT License
+//
+// Copyright 2021 Tyler Coy
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+
+#include <csignal>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <thread>
+#include "host/decode_server.h"
+
+namespace qpsk::host
+{
+
+constexpr uint32_t kSampleRate = 48000;
+constexpr uint32_t kSymbolRate = 8000;
+constexpr uint32_t kPacketSize = 256;
+constexpr uint32_t kBlockSize = kPacketSize * 4;
+constexpr uint32_t kCRCSeed = 0;
+constexpr uint32_t kMaxConnections = 64;
+
+using Server =
+    DecodeServer<kSampleRate, kSymbolRate, kPacketSize, kBlockSize>;
+
+static Server server;
+
+static void OnSignal(int)
+{
+    server.Stop();
+}
+
+// Usage: qpskd <socket path> [max connections] [worker threads]
+extern "C"
+int main(int argc, char* argv[])
+{
+    if (argc < 2)
+    {
+        fprintf(stderr,
+            "usage: %s <socket path> [max connections] [worker threads]\n",
+            argv[0]);
+        return 1;
+    }
+
+    uint32_t max_connections = (argc > 2) ?
+        strtoul(argv[2], nullptr, 0) : kMaxConnections;
+    uint32_t num_workers = (argc > 3) ?
+        strtoul(argv[3], nullptr, 0) : std::thread::hardware_concurrency();
+
+    if (max_connections == 0)
+    {
+        max_connections = kMaxConnections;
+    }
+
+    if (num_workers == 0)
+    {
+        num_workers = 1;
+    }
+
+    if (!server.Init(argv[1], max_connections, num_workers, kCRCSeed))
+    {
+        perror(argv[1]);
+        return 1;
+    }
+
+    signal(SIGINT, OnSignal);
+    signal(SIGTERM, OnSignal);
+    server.Run();
+    return 0;
+}
+
+}
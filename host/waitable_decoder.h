@@ -0,0 +1,100 @@
+// MIT License
+//
+// Copyright 2021 Tyler Coy
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#pragma once
+
+#include <cstdint>
+#include "host/waitable_fifo.h"
+#include "qpsk/decoder.h"
+
+namespace qpsk::host
+{
+
+// Wraps a Decoder for use on a host, where samples are pushed from one thread
+// and decoded on another. Samples are queued in a WaitableFifo in front of the
+// decoder, so the decoding thread sleeps while there's nothing to decode
+// instead of spinning on samples_available(). The decoder's own FIFO only
+// ever holds the one sample about to be processed.
+template <uint32_t sample_rate, uint32_t symbol_rate,
+    uint32_t packet_size, uint32_t block_size, uint32_t fifo_capacity = 256>
+class WaitableDecoder
+{
+public:
+    using DecoderType =
+        Decoder<sample_rate, symbol_rate, packet_size, block_size, 1>;
+
+    void Init(uint32_t crc_seed, uint32_t wake_threshold = 1)
+    {
+        samples_.Init(wake_threshold);
+        decoder_.Init(crc_seed);
+    }
+
+    // Prepare for a new input, even if Close() has been called. Neither
+    // Push() nor Process() may be called until this returns.
+    void Reset(void)
+    {
+        samples_.Reopen();
+        decoder_.Reset();
+    }
+
+    bool Push(float sample)
+    {
+        return samples_.Push(sample);
+    }
+
+    bool Push(float* buffer, uint32_t length)
+    {
+        return samples_.Push(buffer, length);
+    }
+
+    void Close(void)
+    {
+        samples_.Close();
+    }
+
+    // Block until a sample is available, then decode it. Returns false once
+    // the input has been closed and every sample has been decoded.
+    bool Process(Result& result)
+    {
+        float sample;
+
+        if (!samples_.WaitPop(sample))
+        {
+            return false;
+        }
+
+        decoder_.Push(sample);
+        result = decoder_.Process();
+        return true;
+    }
+
+    DecoderType& decoder(void)
+    {
+        return decoder_;
+    }
+
+protected:
+    WaitableFifo<float, fifo_capacity> samples_;
+    DecoderType decoder_;
+};
+
+}
@@ -0,0 +1,205 @@
+// MIT License
+//
+// Copyright 2021 Tyler Coy
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#pragma once
+
+#include <atomic>
+#include <cassert>
+#include <cstdint>
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include "qpsk/inc/fifo.h"
+
+namespace qpsk::host
+{
+
+// A Fifo whose consumer can sleep until items are available, instead of
+// spinning on Pop(). Push() and Pop() remain the lock-free Fifo operations;
+// the only added cost on the producer's side is a fence and a check of
+// whether the consumer is asleep. The consumer is woken once at least
+// wake_threshold items are available, so that a producer delivering samples
+// one at a time doesn't wake it for every sample.
+template <typename T, uint32_t size>
+class WaitableFifo
+{
+public:
+    void Init(uint32_t wake_threshold = 1)
+    {
+        assert(wake_threshold >= 1 && wake_threshold <= size);
+        fifo_.Init();
+        wake_threshold_ = wake_threshold;
+        sequence_ = 0;
+        waiting_ = false;
+        closed_ = false;
+    }
+
+    bool Push(T item)
+    {
+        if (fifo_.Push(item))
+        {
+            Notify();
+            return true;
+        }
+
+        return false;
+    }
+
+    bool Push(T* buffer, uint32_t length)
+    {
+        if (fifo_.Push(buffer, length))
+        {
+            Notify();
+            return true;
+        }
+
+        return false;
+    }
+
+    bool Pop(T& item)
+    {
+        return fifo_.Pop(item);
+    }
+
+    bool Peek(T& item)
+    {
+        return fifo_.Peek(item);
+    }
+
+    // Block until an item can be popped. Returns false only if the FIFO has
+    // been closed and drained.
+    bool WaitPop(T& item)
+    {
+        for (;;)
+        {
+            if (fifo_.Pop(item))
+            {
+                return true;
+            }
+            else if (closed_.load(std::memory_order_acquire))
+            {
+                // The producer may have pushed right before closing.
+                return fifo_.Pop(item);
+            }
+
+            Wait();
+        }
+    }
+
+    // Wake the consumer even if fewer than wake_threshold items are
+    // available, e.g. at the end of a burst of input.
+    void Wake(void)
+    {
+        sequence_.fetch_add(1, std::memory_order_release);
+        syscall(SYS_futex, FutexWord(), FUTEX_WAKE_PRIVATE, 1,
+            nullptr, nullptr, 0);
+    }
+
+    // Signal that no more items will be pushed. The consumer drains what
+    // remains and then WaitPop() returns false.
+    void Close(void)
+    {
+        closed_.store(true, std::memory_order_release);
+        Wake();
+    }
+
+    void Flush(void)
+    {
+        fifo_.Flush();
+    }
+
+    // Discard any items and accept new ones after Close(). Neither the
+    // producer nor the consumer may use the FIFO until this returns.
+    void Reopen(void)
+    {
+        fifo_.Flush();
+        closed_.store(false, std::memory_order_release);
+    }
+
+    uint32_t available(void)
+    {
+        return fifo_.available();
+    }
+
+    bool empty(void)
+    {
+        return fifo_.empty();
+    }
+
+    bool full(void)
+    {
+        return fifo_.full();
+    }
+
+    bool closed(void)
+    {
+        return closed_.load(std::memory_order_acquire);
+    }
+
+protected:
+    static_assert(sizeof(std::atomic<uint32_t>) == sizeof(uint32_t));
+    static_assert(std::atomic<uint32_t>::is_always_lock_free);
+
+    Fifo<T, size> fifo_;
+    uint32_t wake_threshold_;
+    std::atomic<uint32_t> sequence_;
+    std::atomic<bool> waiting_;
+    std::atomic<bool> closed_;
+
+    uint32_t* FutexWord(void)
+    {
+        return reinterpret_cast<uint32_t*>(&sequence_);
+    }
+
+    void Notify(void)
+    {
+        // Pairs with the fence in Wait(). Either the consumer sees our item
+        // before it goes to sleep, or we see that it's waiting.
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+
+        if (waiting_.load(std::memory_order_relaxed) &&
+            fifo_.available() >= wake_threshold_)
+        {
+            Wake();
+        }
+    }
+
+    void Wait(void)
+    {
+        uint32_t sequence = sequence_.load(std::memory_order_acquire);
+        waiting_.store(true, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+
+        if (fifo_.available() < wake_threshold_ &&
+            !closed_.load(std::memory_order_acquire))
+        {
+            // Returns immediately if a wake-up has happened since we read
+            // the sequence number.
+            syscall(SYS_futex, FutexWord(), FUTEX_WAIT_PRIVATE, sequence,
+                nullptr, nullptr, 0);
+        }
+
+        waiting_.store(false, std::memory_order_relaxed);
+    }
+};
+
+}
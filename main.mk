@@ -26,7 +26,7 @@ TARGET_DIR := $(BUILD_DIR)/artifact
 $(TARGET_DIR):
 	mkdir -p $@
 
-SUBMAKEFILES := test.mk sim.mk example.mk
+SUBMAKEFILES := test.mk sim.mk host.mk example.mk
 
 .DEFAULT_GOAL := tests
 
@@ -41,6 +41,10 @@ $(VCD_FILE): $(TARGET_DIR)/$(TARGET)
 .PHONY: run-sim
 run-sim: $(VCD_FILE)
 
+.PHONY: run-margin
+run-margin: $(TARGET_DIR)/$(TARGET)
+	$< --margin unit_tests/data/data.bin
+
 define TGT_POSTCLEAN
 	$(RM) $(VCD_FILE)
 endef
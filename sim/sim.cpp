@@ -31,6 +31,13 @@ extern "C"
 int main(int argc, char* argv[])
 {
     assert(argc > 2);
+
+    if (std::string(argv[1]) == "--margin")
+    {
+        MeasureMargin(std::string(argv[2]));
+        return 0;
+    }
+
     auto vcd_file = std::string(argv[1]);
     auto input_file = std::string(argv[2]);
     auto decode_file = std::string(argc > 3 ? argv[3] : "");
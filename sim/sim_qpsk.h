@@ -24,6 +24,7 @@
 
 #include <stdexcept>
 #include <iostream>
+#include <iomanip>
 #include <fstream>
 #include <climits>
 #include <cstdint>
@@ -47,8 +48,54 @@ constexpr uint32_t kBlockSize = kPacketSize * 4;
 constexpr uint32_t kCRCSeed = 0;
 constexpr uint8_t kFillByte = 0xFF;
 constexpr float kFlashWriteTime = 0.025f;
+constexpr float kResamplingRatio = 1.02f;
+constexpr float kSignalLevel = 0.1f;
+constexpr float kNoiseLevel = 0.025f;
+constexpr float kDCOffset = 0.25f;
+constexpr float kMarginNoiseStep = 0.005f;
 
 using Signal = std::vector<float>;
+using SimDecoder =
+    Decoder<kSampleRate, kSymbolRate, kPacketSize, kBlockSize, 1>;
+
+// Push a sample to the decoder and process it, unless we're still waiting for
+// a simulated flash write to finish.
+template <typename T>
+void Step(SimDecoder& qpsk, float sample, T& decoded_data,
+    int& flash_write_delay, Result& result)
+{
+    qpsk.Push(sample);
+
+    if (flash_write_delay == 0)
+    {
+        result = qpsk.Process();
+
+        if (result == RESULT_BLOCK_COMPLETE)
+        {
+            flash_write_delay = kSampleRate * kFlashWriteTime;
+        }
+
+        if (result == RESULT_PACKET_COMPLETE ||
+            result == RESULT_BLOCK_COMPLETE ||
+            (result == RESULT_ERROR && qpsk.error() == ERROR_CRC))
+        {
+            const uint8_t* packet = qpsk.packet_data();
+            for (uint32_t i = 0; i < kPacketSize; i++)
+            {
+                decoded_data.push_back(packet[i]);
+            }
+        }
+
+        if (result == RESULT_ERROR)
+        {
+            qpsk.Abort();
+        }
+    }
+    else
+    {
+        flash_write_delay--;
+    }
+}
 
 template <typename T>
 Result RunSim(std::string vcd_file, T& decoded_data,
@@ -87,7 +134,7 @@ Result RunSim(std::string vcd_file, T& decoded_data,
     // Correlator vars
     VCDFixedPointVar<8, 16> v_corr_out(vcd, "top.q.dm", "corr.out");
 
-    Decoder<kSampleRate, kSymbolRate, kPacketSize, kBlockSize, 1> qpsk;
+    SimDecoder qpsk;
     qpsk.Init(kCRCSeed);
 
     double time = 0;
@@ -97,37 +144,7 @@ Result RunSim(std::string vcd_file, T& decoded_data,
     Result result;
     for (auto sample : signal)
     {
-        qpsk.Push(sample);
-
-        if (flash_write_delay == 0)
-        {
-            result = qpsk.Process();
-
-            if (result == RESULT_BLOCK_COMPLETE)
-            {
-                flash_write_delay = kSampleRate * kFlashWriteTime;
-            }
-
-            if (result == RESULT_PACKET_COMPLETE ||
-                result == RESULT_BLOCK_COMPLETE ||
-                (result == RESULT_ERROR && qpsk.error() == ERROR_CRC))
-            {
-                const uint8_t* packet = qpsk.packet_data();
-                for (uint32_t i = 0; i < kPacketSize; i++)
-                {
-                    decoded_data.push_back(packet[i]);
-                }
-            }
-
-            if (result == RESULT_ERROR)
-            {
-                qpsk.Abort();
-            }
-        }
-        else
-        {
-            flash_write_delay--;
-        }
+        Step(qpsk, sample, decoded_data, flash_write_delay, result);
 
         v_q_in.change(time, sample);
         v_q_state.change(time, qpsk.state());
@@ -160,6 +177,35 @@ Result RunSim(std::string vcd_file, T& decoded_data,
     return result;
 }
 
+// Same as RunSim, but without tracing, for when we only care about the result.
+template <typename T>
+Result RunDecoder(T& decoded_data, Signal signal)
+{
+    SimDecoder qpsk;
+    qpsk.Init(kCRCSeed);
+
+    int flash_write_delay = 0;
+
+    Result result;
+    for (auto sample : signal)
+    {
+        Step(qpsk, sample, decoded_data, flash_write_delay, result);
+    }
+
+    return result;
+}
+
+inline bool DecodedCorrectly(std::vector<uint8_t> expected_data,
+    const std::vector<uint8_t>& decoded_data)
+{
+    if (decoded_data.size() > expected_data.size())
+    {
+        expected_data.resize(decoded_data.size(), kFillByte);
+    }
+
+    return decoded_data == expected_data;
+}
+
 template <typename T>
 void DumpToFile(std::string file_path, T& container)
 {
@@ -184,27 +230,21 @@ inline void EncodeAndSimulate(std::string vcd_file, std::string bin_file,
         kSymbolRate, kPacketSize, kBlockSize, kFlashWriteTime * 2);
 
     // Resample, attenuate, and add noise
-    static constexpr float kResamplingRatio = 1.02f;
     signal = test::util::Resample(signal, kResamplingRatio);
-    signal = test::util::Scale(signal, 0.1f);
-    signal = test::util::AddNoise(signal, 0.025f);
-    signal = test::util::AddOffset(signal, 0.25f);
+    signal = test::util::Scale(signal, kSignalLevel);
+    signal = test::util::AddNoise(signal, kNoiseLevel);
+    signal = test::util::AddOffset(signal, kDCOffset);
 
     double timestep = 1.0e6 / (kSampleRate * kResamplingRatio);
     auto result = RunSim(vcd_file, decoded_data, signal, timestep);
 
-    if (decoded_data.size() > expected_data.size())
-    {
-        expected_data.resize(decoded_data.size(), kFillByte);
-    }
-
     DumpToFile(decode_file, decoded_data);
 
     if (result != RESULT_END)
     {
         throw std::runtime_error("Error during decoding");
     }
-    else if (decoded_data == expected_data)
+    else if (DecodedCorrectly(expected_data, decoded_data))
     {
         std::cout << "Success!" << std::endl;
     }
@@ -214,6 +254,60 @@ inline void EncodeAndSimulate(std::string vcd_file, std::string bin_file,
     }
 }
 
+// Raise the noise level until decoding fails, and report the highest level at
+// which the data was still decoded correctly. Comparing this figure between
+// builds shows how much a change to the decoder costs in noise immunity.
+inline void MeasureMargin(std::string bin_file)
+{
+    auto expected_data = test::util::LoadBinary(bin_file);
+
+    auto clean_signal = test::util::LoadAudio<Signal>(bin_file,
+        kSymbolRate, kPacketSize, kBlockSize, kFlashWriteTime * 2);
+    clean_signal = test::util::Resample(clean_signal, kResamplingRatio);
+    clean_signal = test::util::Scale(clean_signal, kSignalLevel);
+
+    // The carrier is a sinusoid with power A^2/2, and the noise is uniformly
+    // distributed in [-n, n] with power n^2/3.
+    auto snr = [](float noise_level)
+    {
+        return 10 * std::log10(1.5 * kSignalLevel * kSignalLevel /
+            (noise_level * noise_level));
+    };
+
+    float margin = 0;
+    std::cout << std::fixed << std::setprecision(3);
+
+    for (float noise_level = kMarginNoiseStep; noise_level < 1;
+        noise_level += kMarginNoiseStep)
+    {
+        auto signal = test::util::AddNoise(clean_signal, noise_level);
+        signal = test::util::AddOffset(signal, kDCOffset);
+
+        decltype(expected_data) decoded_data;
+        auto result = RunDecoder(decoded_data, signal);
+        bool success = (result == RESULT_END) &&
+            DecodedCorrectly(expected_data, decoded_data);
+
+        std::cout << "Noise " << noise_level << " (SNR " << snr(noise_level)
+            << " dB): " << (success ? "pass" : "fail") << std::endl;
+
+        if (!success)
+        {
+            break;
+        }
+
+        margin = noise_level;
+    }
+
+    if (margin == 0)
+    {
+        throw std::runtime_error("Failed to decode at the lowest noise level");
+    }
+
+    std::cout << "Decode margin: noise level " << margin
+        << " (SNR " << snr(margin) << " dB)" << std::endl;
+}
+
 inline void Simulate(std::string vcd_file, std::string input_file,
     std::string decode_file = "")
 {
@@ -0,0 +1,228 @@
+// MIT License
+//
+// Copyright 2021 Tyler Coy
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <thread>
+#include <vector>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include <gtest/gtest.h>
+#include "host/decode_server.h"
+#include "unit_tests/util.h"
+
+namespace qpsk::test::decode_server
+{
+
+constexpr uint32_t kSampleRate = 48000;
+constexpr uint32_t kSymbolRate = 8000;
+constexpr uint32_t kPacketSize = 256;
+constexpr uint32_t kBlockSize = 1024;
+constexpr uint32_t kCRCSeed = 0;
+constexpr uint8_t kFillByte = 0xFF;
+constexpr uint32_t kMaxConnections = 4;
+constexpr uint32_t kNumWorkers = 2;
+constexpr uint32_t kNumClients = 6;
+
+using Signal = std::vector<float>;
+using Server = host::DecodeServer<kSampleRate, kSymbolRate,
+    kPacketSize, kBlockSize>;
+
+class DecodeServerTest : public ::testing::Test
+{
+public:
+    static inline Signal test_audio_;
+    static inline std::vector<uint8_t> test_data_;
+
+    std::string path_;
+    Server server_;
+    std::thread thread_;
+
+    static void SetUpTestCase()
+    {
+        std::string bin_file = "unit_tests/data/data.bin";
+        test_data_ = util::LoadBinary(bin_file);
+        test_audio_ = util::LoadAudio<Signal>(bin_file,
+            kSymbolRate, kPacketSize, kBlockSize);
+    }
+
+    void SetUp() override
+    {
+        path_ = "/tmp/qpsk-test-" + std::to_string(getpid()) + ".sock";
+        ASSERT_TRUE(server_.Init(path_.c_str(), kMaxConnections,
+            kNumWorkers, kCRCSeed));
+        thread_ = std::thread([this](void) { server_.Run(); });
+    }
+
+    void TearDown() override
+    {
+        server_.Stop();
+        thread_.join();
+    }
+
+    int Connect(void)
+    {
+        sockaddr_un address = {};
+        address.sun_family = AF_UNIX;
+        strcpy(address.sun_path, path_.c_str());
+
+        int fd = socket(AF_UNIX, SOCK_SEQPACKET, 0);
+        int result = connect(fd, reinterpret_cast<sockaddr*>(&address),
+            sizeof(address));
+        EXPECT_EQ(result, 0);
+        return fd;
+    }
+
+    static void Send(int fd, const Signal& signal)
+    {
+        for (uint32_t offset = 0; offset < signal.size();
+            offset += Server::kMaxMessageSamples)
+        {
+            uint32_t length = std::min<uint32_t>(
+                Server::kMaxMessageSamples, signal.size() - offset);
+            send(fd, &signal[offset], length * sizeof(float), MSG_NOSIGNAL);
+        }
+
+        shutdown(fd, SHUT_WR);
+    }
+
+    // Receive messages until the server closes the connection, collecting
+    // the decoded data. Returns the last message's header.
+    static host::MessageHeader Receive(int fd, std::vector<uint8_t>& data)
+    {
+        host::MessageHeader last = {~0u, 0};
+        uint8_t buffer[sizeof(host::MessageHeader) + kBlockSize];
+
+        for (;;)
+        {
+            ssize_t n = recv(fd, buffer, sizeof(buffer), 0);
+
+            if (n < ssize_t(sizeof(host::MessageHeader)))
+            {
+                break;
+            }
+
+            memcpy(&last, buffer, sizeof(last));
+
+            if (last.type == host::MESSAGE_BLOCK)
+            {
+                data.insert(data.end(), buffer + sizeof(last), buffer + n);
+            }
+        }
+
+        close(fd);
+        return last;
+    }
+
+    // Send the signal from a separate thread while receiving the decoded
+    // data. Returns the final message type.
+    uint32_t Decode(int fd, const Signal& signal, std::vector<uint8_t>& data)
+    {
+        std::thread sender([&](void) { Send(fd, signal); });
+        auto last = Receive(fd, data);
+        sender.join();
+        return last.type;
+    }
+};
+
+TEST_F(DecodeServerTest, MultipleClients)
+{
+    // Use more clients than there are decoders. The extra clients wait until
+    // earlier ones disconnect, and then reuse their decoders.
+    std::vector<std::thread> clients;
+    std::vector<uint8_t> data[kNumClients];
+    uint32_t last[kNumClients];
+
+    for (uint32_t i = 0; i < kNumClients; i++)
+    {
+        clients.emplace_back([&, i](void)
+        {
+            Signal signal = util::Scale(test_audio_, 1.f - 0.1f * i);
+            last[i] = Decode(Connect(), signal, data[i]);
+        });
+    }
+
+    for (auto& client : clients)
+    {
+        client.join();
+    }
+
+    for (uint32_t i = 0; i < kNumClients; i++)
+    {
+        ASSERT_EQ(last[i], host::MESSAGE_END) << "client " << i;
+        ASSERT_GE(data[i].size(), test_data_.size()) << "client " << i;
+        ASSERT_EQ(util::FindMismatch(data[i], test_data_, kFillByte),
+            data[i].size()) << "client " << i;
+    }
+}
+
+TEST_F(DecodeServerTest, InvalidMessage)
+{
+    int fd = Connect();
+
+    // Not a whole number of samples.
+    uint8_t bytes[sizeof(float) + 1] = {};
+    ASSERT_EQ(send(fd, bytes, sizeof(bytes), 0), ssize_t(sizeof(bytes)));
+
+    host::MessageHeader header;
+    ASSERT_EQ(recv(fd, &header, sizeof(header), 0), ssize_t(sizeof(header)));
+    EXPECT_EQ(header.type, host::MESSAGE_ERROR);
+    EXPECT_EQ(header.value, host::kErrorMessage);
+
+    // The server then closes the connection.
+    EXPECT_EQ(recv(fd, &header, sizeof(header), 0), 0);
+    close(fd);
+}
+
+TEST_F(DecodeServerTest, SequentialClient)
+{
+    // Send everything before reading anything.
+    int fd = Connect();
+    std::vector<uint8_t> data;
+    Send(fd, test_audio_);
+    auto last = Receive(fd, data);
+
+    ASSERT_EQ(last.type, host::MESSAGE_END);
+    ASSERT_GE(data.size(), test_data_.size());
+    ASSERT_EQ(util::FindMismatch(data, test_data_, kFillByte), data.size());
+}
+
+TEST_F(DecodeServerTest, IncompleteInput)
+{
+    // Stop sending halfway through. The server reports that decoding didn't
+    // finish before closing the connection.
+    Signal signal(test_audio_.begin(),
+        test_audio_.begin() + test_audio_.size() / 2);
+    int fd = Connect();
+    std::vector<uint8_t> data;
+    Send(fd, signal);
+    auto last = Receive(fd, data);
+
+    EXPECT_EQ(last.type, host::MESSAGE_ERROR);
+    EXPECT_EQ(last.value, host::kErrorIncomplete);
+}
+
+}
@@ -0,0 +1,338 @@
+// MIT License
+//
+// Copyright 2021 Tyler Coy
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <thread>
+#include <vector>
+#include <gtest/gtest.h>
+#include "host/engine.h"
+#include "unit_tests/util.h"
+
+namespace qpsk::test::engine
+{
+
+constexpr uint32_t kSampleRate = 48000;
+constexpr uint32_t kSymbolRate = 8000;
+constexpr uint32_t kPacketSize = 256;
+constexpr uint32_t kBlockSize = 1024;
+constexpr uint32_t kCRCSeed = 0;
+constexpr uint8_t kFillByte = 0xFF;
+constexpr float kFlashWriteTime = 0.025f;
+constexpr uint32_t kNumStreams = 8;
+constexpr uint32_t kNumWorkers = 3;
+constexpr uint32_t kChunkSize = 64;
+constexpr uint32_t kNumBacklogStreams = 8;
+constexpr uint32_t kNumBacklogWorkers = 2;
+constexpr uint32_t kBacklogCapacity = 1 << 18;
+
+using Signal = std::vector<float>;
+using Engine = host::Engine<kSampleRate, kSymbolRate, kPacketSize, kBlockSize>;
+using BacklogEngine = host::Engine<kSampleRate, kSymbolRate,
+    kPacketSize, kBlockSize, kBacklogCapacity>;
+
+class EngineTest : public ::testing::Test
+{
+public:
+    static inline Signal test_audio_;
+    static inline std::vector<uint8_t> test_data_;
+
+    Engine engine_;
+    std::vector<uint8_t> data_[kNumStreams];
+    Result result_[kNumStreams];
+    bool done_[kNumStreams];
+    std::atomic<uint32_t> finished_;
+    bool park_;
+    std::atomic<uint32_t> parked_;
+
+    static void SetUpTestCase()
+    {
+        std::string bin_file = "unit_tests/data/data.bin";
+        test_data_ = util::LoadBinary(bin_file);
+        test_audio_ = util::LoadAudio<Signal>(bin_file,
+            kSymbolRate, kPacketSize, kBlockSize);
+    }
+
+    void SetUp() override
+    {
+        finished_ = 0;
+        park_ = false;
+        parked_ = 0;
+
+        for (auto& done : done_)
+        {
+            done = false;
+        }
+
+        engine_.Init(kNumStreams, kNumWorkers, kCRCSeed,
+            [this](uint32_t stream, Result result, Engine::DecoderType& qpsk)
+            {
+                if (result == RESULT_BLOCK_COMPLETE)
+                {
+                    util::AppendBlock(data_[stream], qpsk.block_data(),
+                        kBlockSize);
+
+                    if (park_)
+                    {
+                        // Leave the block to be written once the test
+                        // resumes the stream.
+                        engine_.Park(stream);
+                        parked_++;
+                    }
+                    else
+                    {
+                        // Simulate a flash write. The stream's samples keep
+                        // queueing meanwhile, and the other streams carry
+                        // on on the other workers.
+                        std::this_thread::sleep_for(
+                            std::chrono::duration<float>(kFlashWriteTime));
+                    }
+                }
+                else if ((result == RESULT_END || result == RESULT_ERROR) &&
+                    !done_[stream])
+                {
+                    result_[stream] = result;
+                    done_[stream] = true;
+                    finished_++;
+                }
+            });
+    }
+
+    void TearDown() override
+    {
+        engine_.Stop();
+    }
+};
+
+TEST_F(EngineTest, MultipleStreams)
+{
+    using namespace std::literals::chrono_literals;
+
+    // Give each stream a differently scaled copy of the signal, and feed
+    // them all in interleaved chunks as if they were being read in real time.
+    std::vector<Signal> signals;
+    for (uint32_t i = 0; i < kNumStreams; i++)
+    {
+        signals.push_back(util::Scale(test_audio_, 1.f - 0.1f * i));
+    }
+
+    for (uint32_t offset = 0; offset < test_audio_.size();
+        offset += kChunkSize)
+    {
+        uint32_t length = std::min<uint32_t>(kChunkSize,
+            test_audio_.size() - offset);
+
+        for (uint32_t i = 0; i < kNumStreams; i++)
+        {
+            while (!engine_.Push(i, &signals[i][offset], length))
+            {
+                std::this_thread::yield();
+            }
+        }
+    }
+
+    auto deadline = std::chrono::steady_clock::now() + 60s;
+    while (finished_ < kNumStreams &&
+        std::chrono::steady_clock::now() < deadline)
+    {
+        std::this_thread::sleep_for(1ms);
+    }
+
+    engine_.Stop();
+    ASSERT_EQ(finished_, kNumStreams);
+
+    for (uint32_t i = 0; i < kNumStreams; i++)
+    {
+        ASSERT_EQ(result_[i], RESULT_END) << "stream " << i;
+        ASSERT_GE(data_[i].size(), test_data_.size()) << "stream " << i;
+        ASSERT_EQ(util::FindMismatch(data_[i], test_data_, kFillByte),
+            data_[i].size()) << "stream " << i;
+    }
+}
+
+TEST_F(EngineTest, ParkAndResume)
+{
+    using namespace std::literals::chrono_literals;
+
+    park_ = true;
+    uint32_t offset = 0;
+    uint32_t resumed = 0;
+
+    auto deadline = std::chrono::steady_clock::now() + 60s;
+    while (finished_ == 0 && std::chrono::steady_clock::now() < deadline)
+    {
+        if (parked_ > resumed)
+        {
+            // Nothing more should be decoded until the stream is resumed.
+            uint32_t length = data_[0].size();
+            std::this_thread::sleep_for(5ms);
+            EXPECT_EQ(data_[0].size(), length);
+            EXPECT_FALSE(engine_.idle(0));
+
+            resumed++;
+            engine_.Resume(0);
+        }
+        else if (offset < test_audio_.size())
+        {
+            uint32_t length = std::min<uint32_t>(kChunkSize,
+                test_audio_.size() - offset);
+
+            if (engine_.Push(0, &test_audio_[offset], length))
+            {
+                offset += length;
+            }
+        }
+        else
+        {
+            std::this_thread::sleep_for(1ms);
+        }
+    }
+
+    engine_.Stop();
+    ASSERT_EQ(finished_, 1);
+    ASSERT_EQ(result_[0], RESULT_END);
+    EXPECT_EQ(resumed, data_[0].size() / kBlockSize);
+    ASSERT_GE(data_[0].size(), test_data_.size());
+    ASSERT_EQ(util::FindMismatch(data_[0], test_data_, kFillByte),
+        data_[0].size());
+}
+
+class EngineBacklogTest : public ::testing::Test
+{
+public:
+    static inline Signal test_audio_;
+
+    BacklogEngine engine_;
+    std::atomic<bool> go_;
+    std::atomic<bool> ended_;
+    std::atomic<uint32_t> packets_[kNumBacklogStreams];
+    uint32_t min_packets_at_end_;
+    std::atomic<uint32_t> finished_;
+
+    static void SetUpTestCase()
+    {
+        test_audio_ = util::LoadAudio<Signal>("unit_tests/data/data.bin",
+            kSymbolRate, kPacketSize, kBlockSize);
+    }
+
+    void SetUp() override
+    {
+        go_ = false;
+        ended_ = false;
+        finished_ = 0;
+
+        for (auto& packets : packets_)
+        {
+            packets = 0;
+        }
+
+        engine_.Init(kNumBacklogStreams, kNumBacklogWorkers, kCRCSeed,
+            [this](uint32_t stream, Result result, BacklogEngine::DecoderType&)
+            {
+                // Hold the workers until every stream has a backlog.
+                while (!go_)
+                {
+                    std::this_thread::yield();
+                }
+
+                if (result == RESULT_PACKET_COMPLETE)
+                {
+                    packets_[stream]++;
+                }
+                else if (result == RESULT_END || result == RESULT_ERROR)
+                {
+                    // Note how far the slowest stream had got when the first
+                    // one finished.
+                    if (!ended_.exchange(true))
+                    {
+                        min_packets_at_end_ = ~0;
+
+                        for (auto& packets : packets_)
+                        {
+                            min_packets_at_end_ = std::min<uint32_t>(
+                                min_packets_at_end_, packets);
+                        }
+
+                        finished_++;
+                    }
+                }
+            });
+    }
+
+    void TearDown() override
+    {
+        engine_.Stop();
+    }
+};
+
+TEST_F(EngineBacklogTest, AllStreamsProgress)
+{
+    using namespace std::literals::chrono_literals;
+
+    ASSERT_LE(test_audio_.size(), kBacklogCapacity);
+
+    // Queue each stream's whole input at once, so that there are many more
+    // backlogged streams than workers.
+    Signal signal = util::Scale(test_audio_, 0.5f);
+
+    for (uint32_t i = 0; i < kNumBacklogStreams; i++)
+    {
+        ASSERT_TRUE(engine_.Push(i, signal.data(), signal.size()));
+    }
+
+    go_ = true;
+
+    auto deadline = std::chrono::steady_clock::now() + 60s;
+    while (finished_ == 0 && std::chrono::steady_clock::now() < deadline)
+    {
+        std::this_thread::sleep_for(1ms);
+    }
+
+    engine_.Stop();
+    ASSERT_EQ(finished_, 1);
+
+    // Every stream should have been given turns while the others were
+    // decoding, rather than waiting for them to finish.
+    uint32_t num_packets = util::LoadBinary("unit_tests/data/data.bin").size()
+        / kPacketSize;
+    EXPECT_GE(min_packets_at_end_, num_packets / 2);
+}
+
+TEST_F(EngineBacklogTest, StopDiscardsBacklog)
+{
+    Signal signal = util::Scale(test_audio_, 0.5f);
+
+    for (uint32_t i = 0; i < kNumBacklogStreams; i++)
+    {
+        ASSERT_TRUE(engine_.Push(i, signal.data(), signal.size()));
+    }
+
+    // Stopping shouldn't wait for the backlog to be decoded.
+    go_ = true;
+    engine_.Stop();
+    EXPECT_EQ(finished_, 0);
+}
+
+}
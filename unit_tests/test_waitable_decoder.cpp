@@ -0,0 +1,148 @@
+// MIT License
+//
+// Copyright 2021 Tyler Coy
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <string>
+#include <thread>
+#include <vector>
+#include <gtest/gtest.h>
+#include "host/waitable_decoder.h"
+#include "unit_tests/util.h"
+
+namespace qpsk::test::waitable_decoder
+{
+
+constexpr uint32_t kSampleRate = 48000;
+constexpr uint32_t kSymbolRate = 8000;
+constexpr uint32_t kPacketSize = 256;
+constexpr uint32_t kBlockSize = 1024;
+constexpr uint32_t kCRCSeed = 0;
+constexpr uint8_t kFillByte = 0xFF;
+constexpr uint32_t kChunkSize = 64;
+constexpr uint32_t kWakeThreshold = 32;
+
+using Signal = std::vector<float>;
+
+class WaitableDecoderTest : public ::testing::Test
+{
+public:
+    static inline Signal test_audio_;
+    static inline std::vector<uint8_t> test_data_;
+
+    host::WaitableDecoder<kSampleRate, kSymbolRate,
+        kPacketSize, kBlockSize> qpsk_;
+
+    static void SetUpTestCase()
+    {
+        std::string bin_file = "unit_tests/data/data.bin";
+        test_data_ = util::LoadBinary(bin_file);
+        test_audio_ = util::LoadAudio<Signal>(bin_file,
+            kSymbolRate, kPacketSize, kBlockSize);
+    }
+
+    void SetUp() override
+    {
+        qpsk_.Init(kCRCSeed, kWakeThreshold);
+    }
+
+    // Push the test audio from one thread while decoding it on this one, then
+    // close the input. Returns once Process() reports that the input has been
+    // closed and drained.
+    void Decode(void)
+    {
+        std::atomic<bool> stopped = false;
+
+        std::thread producer([&](void)
+        {
+            for (uint32_t offset = 0; offset < test_audio_.size();
+                offset += kChunkSize)
+            {
+                uint32_t length = std::min<uint32_t>(kChunkSize,
+                    test_audio_.size() - offset);
+
+                while (!qpsk_.Push(&test_audio_[offset], length))
+                {
+                    // Don't wait forever if the consumer stopped early.
+                    if (stopped)
+                    {
+                        return;
+                    }
+
+                    std::this_thread::yield();
+                }
+            }
+
+            qpsk_.Close();
+        });
+
+        std::vector<uint8_t> data;
+        bool ended = false;
+        Result result;
+
+        while (qpsk_.Process(result))
+        {
+            if (ended)
+            {
+                continue;
+            }
+            else if (result == RESULT_ERROR)
+            {
+                ADD_FAILURE() << "error " << qpsk_.decoder().error();
+                ended = true;
+            }
+            else if (result == RESULT_END)
+            {
+                ended = true;
+            }
+            else if (result == RESULT_BLOCK_COMPLETE)
+            {
+                util::AppendBlock(data, qpsk_.decoder().block_data(),
+                    kBlockSize);
+            }
+        }
+
+        stopped = true;
+        producer.join();
+
+        ASSERT_TRUE(ended);
+        ASSERT_GE(data.size(), test_data_.size());
+        ASSERT_EQ(util::FindMismatch(data, test_data_, kFillByte),
+            data.size());
+    }
+};
+
+TEST_F(WaitableDecoderTest, Decode)
+{
+    Decode();
+}
+
+TEST_F(WaitableDecoderTest, ResetAndReuse)
+{
+    Decode();
+    qpsk_.Reset();
+    Decode();
+}
+
+}
@@ -0,0 +1,144 @@
+// MIT License
+//
+// Copyright 2021 Tyler Coy
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#include <atomic>
+#include <cstdint>
+#include <type_traits>
+#include <thread>
+#include <chrono>
+#include <gtest/gtest.h>
+#include "host/waitable_fifo.h"
+
+namespace qpsk::test::waitable_fifo
+{
+
+using FifoSizes = ::testing::Types<
+    std::integral_constant<uint32_t, 4096>,
+    std::integral_constant<uint32_t, 16>,
+    std::integral_constant<uint32_t, 2>,
+    std::integral_constant<uint32_t, 1>>;
+
+template <typename T>
+class WaitableFifoTest : public ::testing::Test
+{
+protected:
+    static constexpr uint32_t kSize = T::value;
+    static constexpr uint32_t kTestLength = 100000;
+    host::WaitableFifo<uint32_t, kSize> fifo_;
+    std::thread producer_;
+
+    void SetUp() override
+    {
+        fifo_.Init();
+    }
+
+    void TearDown() override
+    {
+        producer_.join();
+    }
+};
+
+TYPED_TEST_CASE(WaitableFifoTest, FifoSizes);
+
+TYPED_TEST(WaitableFifoTest, ProducerBound)
+{
+    using namespace std::literals::chrono_literals;
+
+    this->producer_ = std::thread([&](void)
+    {
+        std::this_thread::sleep_for(10ms);
+
+        for (uint32_t i = 0; i < this->kTestLength; i++)
+        {
+            while (this->fifo_.Push(i) == false);
+            std::this_thread::yield();
+        }
+    });
+
+    for (uint32_t i = 0; i < this->kTestLength; i++)
+    {
+        uint32_t item;
+        ASSERT_TRUE(this->fifo_.WaitPop(item));
+        ASSERT_EQ(item, i);
+    }
+
+    ASSERT_TRUE(this->fifo_.empty());
+}
+
+TYPED_TEST(WaitableFifoTest, Close)
+{
+    using namespace std::literals::chrono_literals;
+
+    this->producer_ = std::thread([&](void)
+    {
+        for (uint32_t i = 0; i < this->kTestLength; i++)
+        {
+            while (this->fifo_.Push(i) == false);
+        }
+
+        std::this_thread::sleep_for(10ms);
+        this->fifo_.Close();
+    });
+
+    for (uint32_t i = 0; i < this->kTestLength; i++)
+    {
+        uint32_t item;
+        ASSERT_TRUE(this->fifo_.WaitPop(item));
+        ASSERT_EQ(item, i);
+    }
+
+    uint32_t item;
+    ASSERT_FALSE(this->fifo_.WaitPop(item));
+    ASSERT_TRUE(this->fifo_.closed());
+    ASSERT_TRUE(this->fifo_.empty());
+}
+
+TEST(WaitableFifoTest, WakeThreshold)
+{
+    using namespace std::literals::chrono_literals;
+
+    constexpr uint32_t kThreshold = 8;
+    host::WaitableFifo<uint32_t, 16> fifo;
+    fifo.Init(kThreshold);
+    std::atomic<uint32_t> pushed = 0;
+
+    std::thread producer([&](void)
+    {
+        std::this_thread::sleep_for(10ms);
+
+        for (uint32_t i = 0; i < kThreshold; i++)
+        {
+            std::this_thread::sleep_for(1ms);
+            pushed = i + 1;
+            fifo.Push(i);
+        }
+    });
+
+    // The consumer shouldn't be woken until the threshold has been reached.
+    uint32_t item;
+    ASSERT_TRUE(fifo.WaitPop(item));
+    EXPECT_EQ(pushed, kThreshold);
+    EXPECT_EQ(item, 0);
+    producer.join();
+}
+
+}
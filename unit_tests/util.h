@@ -203,4 +203,34 @@ inline std::vector<uint8_t> LoadBinary(std::string file_path)
     return bin_data;
 }
 
+// Append a decoded block's bytes to data, in the order they were encoded.
+inline void AppendBlock(std::vector<uint8_t>& data, const uint32_t* block,
+    uint32_t block_size)
+{
+    for (uint32_t i = 0; i < block_size / 4; i++)
+    {
+        data.push_back(block[i] >>  0);
+        data.push_back(block[i] >>  8);
+        data.push_back(block[i] >> 16);
+        data.push_back(block[i] >> 24);
+    }
+}
+
+// Compare decoded data with the data that was encoded, which the last block
+// pads out with fill bytes. Returns the index of the first byte that differs,
+// or data.size() if none do.
+inline size_t FindMismatch(const std::vector<uint8_t>& data,
+    const std::vector<uint8_t>& expected, uint8_t fill_byte)
+{
+    for (size_t i = 0; i < data.size(); i++)
+    {
+        if (data[i] != ((i < expected.size()) ? expected[i] : fill_byte))
+        {
+            return i;
+        }
+    }
+
+    return data.size();
+}
+
 }